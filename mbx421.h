@@ -0,0 +1,46 @@
+#ifndef MBX421_H
+#define MBX421_H
+
+//shared between os-proj1.c and userspace callers of mbx421_submit.
+//every field is fixed width and pointers travel as __u64, so 32 and 64 bit
+//callers see the same layout and no compat syscall is needed.
+#include <linux/types.h>
+
+#define MBX421_OP_CREATE     1
+#define MBX421_OP_DESTROY    2
+#define MBX421_OP_SEND       3
+#define MBX421_OP_RECV       4
+#define MBX421_OP_ACL_ADD    5
+#define MBX421_OP_ACL_REMOVE 6
+
+#define MBX421_SUBMIT_MAX 4096 //max entries per mbx421_submit call
+
+#define MBX421_SUBMIT_BYTES (4 << 20) //max send bytes per mbx421_submit call, more fails with -E2BIG
+
+#define MBX421_MSG_MAX 65536 //max bytes per sent message
+
+struct mbx421_sqe {
+
+    __u32 opcode; // MBX421_OP_*
+
+    __s32 process_id; // used by the ACL ops
+
+    __u64 id; // mailbox id
+
+    __u64 msg; // user buffer for send and recv, (__u64)(uintptr_t)ptr
+
+    __s64 len; // used by send and recv
+
+    __u64 user_data; // copied untouched into the matching completion
+
+};
+
+struct mbx421_cqe {
+
+    __u64 user_data;
+
+    __s64 res; // what the single syscall would have returned
+
+};
+
+#endif
@@ -0,0 +1,1051 @@
+//=====================//
+//===Start KUnitTests==//
+//=====================//
+//#included at the end of os-proj1.c when CONFIG_MBX421_KUNIT_TEST is set, so the
+//static skip list, queue and ACL code is reachable. run under QEMU with
+//  ./tools/testing/kunit/kunit.py run --kunitconfig=<dir holding .kunitconfig> --arch=x86_64
+//every case starts from a fresh list made by mbx_test_init and torn down by mbx_test_exit.
+#include <kunit/test.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/mman.h>
+#include <linux/bitmap.h>
+
+#define MBX_TEST_PTRS 8
+#define MBX_TEST_PROB 2
+#define MBX_TEST_IDS 256 // ids 1..MBX_TEST_IDS for the randomized cases
+
+//---locked entry points, the same lock + search + do_ sequence the syscalls use---
+
+static long t_create(unsigned long id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_create(id, search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+static long t_destroy(unsigned long id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_destroy(id, search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+static long t_count(unsigned long id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_count(search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+static long t_length(unsigned long id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_length(search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+static long t_send(unsigned long id, unsigned char __user * msg, long len){
+    return do_send(id, msg, len); // takes mbx_lock itself
+}
+
+static long t_recv(unsigned long id, unsigned char __user * msg, long len){
+    return do_recv(id, msg, len); // takes mbx_lock itself
+}
+
+static long t_acl_add(unsigned long id, pid_t pid){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_acl_add(search(id), pid);
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+static long t_acl_remove(unsigned long id, pid_t pid){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_acl_remove(search(id), pid);
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+static long t_set_ttl(unsigned long id, unsigned long ttl_ms){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_set_ttl(search(id), ttl_ms);
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+//send from a kernel buffer, for kthreads that have no user memory. the message is a u32 tag
+static long t_queue(unsigned long id, u32 tag){
+    u32* kernMsg = kmalloc(sizeof(u32), GFP_KERNEL);
+    long ret;
+    if(!kernMsg) return -ENOMEM;
+    *kernMsg = tag;
+    mutex_lock(&mbx_lock);
+    ret = (theList == 0) ? -ENOENT : insert(id, (unsigned long)kernMsg, sizeof(u32));
+    mutex_unlock(&mbx_lock);
+    if(ret != 0) kfree(kernMsg);
+    return ret;
+}
+
+//recv into a kernel u32, the kernel side twin of t_queue
+static long t_take(unsigned long id, u32* tag){
+    sl_node* temp;
+    q_node_t* node = 0;
+    long ret = -ENOENT;
+    mutex_lock(&mbx_lock);
+    temp = search(id);
+    if(temp != 0){
+        expireQ(temp->mailBox);
+        node = recvQ(temp->mailBox);
+        ret = node ? 0 : -EAGAIN;
+    }
+    mutex_unlock(&mbx_lock);
+    if(node){
+        *tag = *(u32*)node->data;
+        kfree((void*)node->data);
+        kfree(node);
+    }
+    return ret;
+}
+
+//page of user memory in the test's own mm, for the copy_to/from_user paths
+static unsigned char __user * t_user_buf(struct kunit* test, unsigned long size){
+    unsigned long addr = kunit_vm_mmap(test, NULL, 0, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0);
+    KUNIT_ASSERT_NE_MSG(test, addr, 0, "could not create userspace mm");
+    KUNIT_ASSERT_LT_MSG(test, addr, (unsigned long)TASK_SIZE, "could not allocate user memory");
+    return (unsigned char __user *)addr;
+}
+
+static long q_len(fifo_queue_t* q){
+    long count = 0;
+    q_node_t* temp = q->front;
+    while(temp != 0){
+        count++;
+        temp = temp->nextNode;
+    }
+    return count;
+}
+
+//skip list invariants: every level sorted and a sublist of the one below, the head never
+//linked in as a mailbox, levels above theList->level empty, caller holds mbx_lock
+static void check_skip_list(struct kunit* test){
+    unsigned int i;
+    long below = -1;
+
+    KUNIT_ASSERT_NOT_NULL(test, theList);
+    KUNIT_EXPECT_GE(test, theList->level, 1u);
+    KUNIT_EXPECT_LE(test, theList->level, MAX_LEVEL);
+    KUNIT_EXPECT_EQ(test, theList->head->id, MAXNUMBER);
+
+    for(i = 1; i <= MAX_LEVEL; i++){
+        sl_node* n = theList->head->forwardNodes[i];
+        unsigned long last = 0;
+        long count = 0;
+
+        if(i > theList->level){
+            KUNIT_EXPECT_PTR_EQ(test, n, theList->head);
+            continue;
+        }
+        while(n != theList->head){
+            KUNIT_EXPECT_GT(test, n->id, last); // strictly ascending, ids start at 1
+            KUNIT_EXPECT_PTR_EQ(test, search(n->id), n); // reachable from the top, so also on every lower level
+            last = n->id;
+            n = n->forwardNodes[i];
+            count++;
+            if(count > 1000000) break; // cycle guard
+        }
+        if(below >= 0){
+            KUNIT_EXPECT_LE(test, count, below);
+        }
+        below = count;
+    }
+}
+
+static int mbx_test_init(struct kunit* test){
+    do_shutdown();
+    KUNIT_ASSERT_EQ(test, do_init(MBX_TEST_PTRS, MBX_TEST_PROB), 0);
+    return 0;
+}
+
+static void mbx_test_exit(struct kunit* test){
+    do_shutdown();
+}
+
+//---randomized invariants---
+
+static void mbx_test_skip_list_random(struct kunit* test){
+    DECLARE_BITMAP(exists, MBX_TEST_IDS + 1);
+    unsigned long id;
+    int i;
+
+    bitmap_zero(exists, MBX_TEST_IDS + 1);
+    for(i = 0; i < 4000; i++){
+        id = 1 + get_random_u32_below(MBX_TEST_IDS);
+        if(get_random_u32_below(3) != 0){
+            KUNIT_EXPECT_EQ(test, t_create(id), test_bit(id, exists) ? (long)-EEXIST : 0L);
+            __set_bit(id, exists);
+        }else{
+            KUNIT_EXPECT_EQ(test, t_destroy(id), test_bit(id, exists) ? 0L : (long)-ENOENT);
+            __clear_bit(id, exists);
+        }
+    }
+
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    for(id = 1; id <= MBX_TEST_IDS; id++){
+        sl_node* n = search(id);
+        KUNIT_EXPECT_EQ(test, n != 0, (bool)test_bit(id, exists));
+    }
+    mutex_unlock(&mbx_lock);
+}
+
+static void mbx_test_queue_random(struct kunit* test){
+    u32 sent[8] = {0};
+    u32 taken[8] = {0};
+    u32 tag;
+    int i;
+
+    for(i = 0; i < 4000; i++){
+        unsigned int box = get_random_u32_below(8);
+        if(get_random_u32_below(2) == 0){
+            KUNIT_EXPECT_EQ(test, t_queue(box + 1, sent[box]), 0L);
+            sent[box]++;
+        }else if(taken[box] < sent[box]){
+            KUNIT_EXPECT_EQ(test, t_take(box + 1, &tag), 0L);
+            KUNIT_EXPECT_EQ(test, tag, taken[box]); // fifo order per mailbox
+            taken[box]++;
+        }else if(sent[box] != 0){
+            KUNIT_EXPECT_EQ(test, t_take(box + 1, &tag), (long)-EAGAIN);
+        }
+    }
+    for(i = 0; i < 8; i++){
+        if(sent[i] != 0){
+            KUNIT_EXPECT_EQ(test, t_count(i + 1), (long)(sent[i] - taken[i]));
+        }
+    }
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    mutex_unlock(&mbx_lock);
+}
+
+static void mbx_test_acl_random(struct kunit* test){
+    ACL_LIST_T* ACL = createACL(killACL, insert_ACL_node, checkExist, deleteAllowedID, dumpList);
+    DECLARE_BITMAP(allowed, 64);
+    int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, ACL);
+    bitmap_zero(allowed, 64);
+    for(i = 0; i < 2000; i++){
+        pid_t pid = get_random_u32_below(64);
+        if(get_random_u32_below(2) == 0){
+            if(!test_bit(pid, allowed)){
+                ACL->insert_ACL_node(&ACL->h, pid);
+                __set_bit(pid, allowed);
+            }
+        }else{
+            KUNIT_EXPECT_EQ(test, ACL->deleteAllowedID(&ACL->h, pid), test_bit(pid, allowed) ? 0 : 1);
+            __clear_bit(pid, allowed);
+        }
+        KUNIT_EXPECT_EQ(test, ACL->checkExist(&ACL->h, pid), test_bit(pid, allowed) ? 0 : 1);
+    }
+    ACL->killACL(&ACL->h);
+    KUNIT_EXPECT_NULL(test, ACL->h);
+    kfree(ACL);
+}
+
+//---concurrent stress---
+
+#define MBX_STRESS_THREADS 4
+#define MBX_STRESS_OPS 5000
+
+typedef struct mbx_stress {
+
+    struct completion done;
+
+    unsigned long unexpected; // results outside what the op may return
+
+} mbx_stress_t;
+
+//messages in q carrying an expiry stamp, what q->stamped must match
+static unsigned long q_stamped(fifo_queue_t* q){
+    unsigned long count = 0;
+    q_node_t* temp = q->front;
+    while(temp != 0){
+        if(temp->expires != 0) count++;
+        temp = temp->nextNode;
+    }
+    return count;
+}
+
+//kthreads have no mm, so the stress ops use the kernel buffer twins of send and recv
+static int mbx_stress_thread(void* arg){
+    mbx_stress_t* s = arg;
+    u32 tag;
+    long ret;
+    int i;
+
+    for(i = 0; i < MBX_STRESS_OPS; i++){
+        unsigned long id = 1 + get_random_u32_below(32);
+        switch(get_random_u32_below(10)){
+            case 0:
+                ret = t_create(id);
+                if(ret != 0 && ret != -EEXIST) s->unexpected++;
+                break;
+            case 1:
+                ret = t_destroy(id);
+                if(ret != 0 && ret != -ENOENT) s->unexpected++;
+                break;
+            case 2:
+            case 3:
+            case 4:
+                ret = t_queue(id, i);
+                if(ret != 0) s->unexpected++;
+                break;
+            case 5:
+            case 6:
+                ret = t_take(id, &tag);
+                if(ret != 0 && ret != -EAGAIN && ret != -ENOENT) s->unexpected++;
+                break;
+            case 7:
+                ret = t_set_ttl(id, get_random_u32_below(6)); // 0..5ms, 0 turns it back off
+                if(ret != 0 && ret != -ENOENT) s->unexpected++;
+                break;
+            case 8:
+                reap_slice(NULL); // the delayed work runs too, this just makes it race more often
+                break;
+            default:
+                ret = t_acl_add(id, get_random_u32_below(64));
+                if(ret != 0 && ret != -ENOENT) s->unexpected++;
+                break;
+        }
+    }
+    complete(&s->done);
+    return 0;
+}
+
+static void mbx_test_concurrent_stress(struct kunit* test){
+    mbx_stress_t* s = kunit_kcalloc(test, MBX_STRESS_THREADS, sizeof(mbx_stress_t), GFP_KERNEL);
+    struct task_struct* task;
+    unsigned long id, total = 0;
+    int i, started = 0;
+
+    KUNIT_ASSERT_NOT_NULL(test, s);
+    for(i = 0; i < MBX_STRESS_THREADS; i++){
+        init_completion(&s[i].done);
+        task = kthread_run(mbx_stress_thread, &s[i], "mbx421_stress/%d", i);
+        KUNIT_EXPECT_FALSE(test, IS_ERR(task));
+        if(IS_ERR(task)) break;
+        started++;
+    }
+    for(i = 0; i < started; i++){ // only the started ones, the rest never touch s[]
+        wait_for_completion(&s[i].done);
+        KUNIT_EXPECT_EQ(test, s[i].unexpected, 0UL);
+    }
+
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    for(id = 1; id <= 32; id++){
+        sl_node* n = search(id);
+        if(n != 0){
+            KUNIT_EXPECT_EQ(test, n->mailBox->stamped, q_stamped(n->mailBox));
+            total += n->mailBox->stamped;
+        }
+    }
+    KUNIT_EXPECT_EQ(test, stamped_total, total);
+    mutex_unlock(&mbx_lock);
+}
+
+//---regressions, one per fixed bug---
+
+//killQ used to kfree the address of fifo_queue_t.front, which is the queue itself
+static void mbx_test_killq_keeps_queue(struct kunit* test){
+    fifo_queue_t* q = createQ(enqueue, dequeue, dumpQ, killQ, reapQ);
+    int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, q);
+    for(i = 0; i < 3; i++){
+        KUNIT_EXPECT_EQ(test, sendQ(q, (unsigned long)kmalloc(8, GFP_KERNEL), 8), 0);
+    }
+    q->killQ(&q->front);
+    KUNIT_EXPECT_NULL(test, q->front);
+    q->killQ(&q->front); // empty queue is fine too
+    kfree(q); // a double free here under KASAN is the old bug
+}
+
+//killACL used to kfree the address of ACL_LIST_T.h
+static void mbx_test_killacl_keeps_list(struct kunit* test){
+    ACL_LIST_T* ACL = createACL(killACL, insert_ACL_node, checkExist, deleteAllowedID, dumpList);
+
+    KUNIT_ASSERT_NOT_NULL(test, ACL);
+    ACL->insert_ACL_node(&ACL->h, 1);
+    ACL->insert_ACL_node(&ACL->h, 2);
+    ACL->killACL(&ACL->h);
+    KUNIT_EXPECT_NULL(test, ACL->h);
+    kfree(ACL);
+}
+
+//MAXNUMBER was (2^63)-1 == 60, every id above 60 sorted after the head
+static void mbx_test_maxnumber(struct kunit* test){
+    KUNIT_EXPECT_EQ(test, MAXNUMBER, ULONG_MAX);
+    KUNIT_EXPECT_EQ(test, t_create(1000), 0L);
+    KUNIT_EXPECT_EQ(test, t_create(1UL << 40), 0L);
+    KUNIT_EXPECT_EQ(test, t_create(61), 0L);
+    KUNIT_EXPECT_EQ(test, t_create(ULONG_MAX), (long)-EINVAL);
+
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_NOT_NULL(test, search(61));
+    KUNIT_EXPECT_NOT_NULL(test, search(1000));
+    KUNIT_EXPECT_NOT_NULL(test, search(1UL << 40));
+    check_skip_list(test);
+    mutex_unlock(&mbx_lock);
+}
+
+//search(ULONG_MAX) used to return the head, and destroy would free it
+static void mbx_test_head_sentinel(struct kunit* test){
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_NULL(test, search(ULONG_MAX));
+    KUNIT_EXPECT_EQ(test, delete(MAXNUMBER), (long)-ENOENT);
+    mutex_unlock(&mbx_lock);
+
+    KUNIT_EXPECT_EQ(test, t_destroy(ULONG_MAX), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_queue(ULONG_MAX, 1), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, t_take(ULONG_MAX, &(u32){0}), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_count(ULONG_MAX), (long)-ENOENT);
+
+    KUNIT_EXPECT_EQ(test, t_create(5), 0L); // list still usable
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    KUNIT_EXPECT_EQ(test, q_len(theList->head->mailBox), 0L);
+    mutex_unlock(&mbx_lock);
+}
+
+//runs fn in a kthread with a non root uid, ACL checks only apply to non root callers
+typedef struct mbx_user_call {
+
+    struct completion done;
+
+    unsigned long id;
+
+    long (*fn)(unsigned long id);
+
+    long ret;
+
+} mbx_user_call_t;
+
+static int mbx_user_thread(void* arg){
+    mbx_user_call_t* c = arg;
+    struct cred* cred = prepare_creds();
+
+    if(!cred){
+        c->ret = -ENOMEM;
+    }else{
+        cred->uid = KUIDT_INIT(1000);
+        cred->euid = KUIDT_INIT(1000);
+        commit_creds(cred); // only this thread changes uid, it exits right after
+        c->ret = c->fn(c->id);
+    }
+    complete(&c->done);
+    return 0;
+}
+
+//pid_t of the thread is what the ACL holds, so allow or deny it before it runs
+static long run_as_user(struct kunit* test, long (*fn)(unsigned long), unsigned long id, bool allow){
+    mbx_user_call_t c;
+    struct task_struct* task;
+
+    init_completion(&c.done);
+    c.id = id;
+    c.fn = fn;
+    c.ret = 0;
+    task = kthread_create(mbx_user_thread, &c, "mbx421_user");
+    KUNIT_ASSERT_FALSE(test, IS_ERR(task));
+    if(allow){
+        KUNIT_EXPECT_EQ(test, t_acl_add(id, task_pid_nr(task)), 0L);
+    }else{
+        KUNIT_EXPECT_EQ(test, t_acl_add(id, task_pid_nr(task) + 100000), 0L); // someone else
+    }
+    wake_up_process(task);
+    wait_for_completion(&c.done);
+    return c.ret;
+}
+
+//ACL checks treated checkExist's 0 (found) as not found
+static void mbx_test_acl_permission(struct kunit* test){
+    KUNIT_ASSERT_EQ(test, t_create(7), 0L);
+    KUNIT_EXPECT_EQ(test, run_as_user(test, t_count, 7, true), 0L);
+    KUNIT_EXPECT_EQ(test, run_as_user(test, t_length, 7, true), (long)-EAGAIN);
+    KUNIT_EXPECT_EQ(test, run_as_user(test, t_destroy, 7, true), 0L);
+
+    KUNIT_ASSERT_EQ(test, t_create(8), 0L);
+    KUNIT_EXPECT_EQ(test, run_as_user(test, t_count, 8, false), (long)-EPERM);
+    KUNIT_EXPECT_EQ(test, run_as_user(test, t_destroy, 8, false), (long)-EPERM);
+    KUNIT_EXPECT_EQ(test, t_destroy(8), 0L); // root still can
+}
+
+//mbx421_length used to dereference a NULL ACL for non root callers
+static void mbx_test_length_null_acl(struct kunit* test){
+    mbx_user_call_t c;
+    struct task_struct* task;
+
+    KUNIT_ASSERT_EQ(test, t_create(9), 0L);
+    KUNIT_EXPECT_EQ(test, t_queue(9, 1), 0L);
+    init_completion(&c.done);
+    c.id = 9;
+    c.fn = t_length;
+    task = kthread_run(mbx_user_thread, &c, "mbx421_user"); // no acl_add, the mailbox keeps ACL == 0
+    KUNIT_ASSERT_FALSE(test, IS_ERR(task));
+    wait_for_completion(&c.done);
+    KUNIT_EXPECT_EQ(test, c.ret, (long)sizeof(u32));
+}
+
+//getLevel could return MAX_LEVEL+1 and write past forwardNodes
+static void mbx_test_getlevel_bound(struct kunit* test){
+    unsigned int level;
+    int i;
+
+    do_shutdown();
+    KUNIT_ASSERT_EQ(test, do_init(2, 2), 0L);
+    for(i = 0; i < 100000; i++){
+        level = getLevel();
+        KUNIT_EXPECT_GE(test, level, 1u);
+        KUNIT_ASSERT_LE(test, level, MAX_LEVEL);
+    }
+    for(i = 1; i <= 500; i++){
+        KUNIT_EXPECT_EQ(test, t_create(i), 0L);
+    }
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    mutex_unlock(&mbx_lock);
+}
+
+//re-init used to change MAX_LEVEL under an existing head, and ptrs was unbounded
+static void mbx_test_init_bounds(struct kunit* test){
+    KUNIT_EXPECT_EQ(test, MAX_LEVEL, (unsigned int)MBX_TEST_PTRS);
+    KUNIT_EXPECT_EQ(test, do_init(MBX421_MAX_PTRS, 4), 0L);
+    KUNIT_EXPECT_EQ(test, MAX_LEVEL, (unsigned int)MBX_TEST_PTRS); // head keeps its size
+    KUNIT_EXPECT_EQ(test, PROBABILITY, (unsigned int)MBX_TEST_PROB);
+    KUNIT_EXPECT_EQ(test, do_init(MBX421_MAX_PTRS + 1, 2), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, do_init(UINT_MAX, 2), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, do_init(0, 2), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, do_init(4, 3), (long)-EINVAL);
+}
+
+//killAll used to read nodes delete had already freed, then free the head twice
+static void mbx_test_killall(struct kunit* test){
+    int i;
+
+    for(i = 1; i <= 200; i++){
+        KUNIT_EXPECT_EQ(test, t_create(i), 0L);
+        KUNIT_EXPECT_EQ(test, t_queue(i, i), 0L);
+        KUNIT_EXPECT_EQ(test, t_acl_add(i, i), 0L);
+    }
+    KUNIT_EXPECT_EQ(test, do_shutdown(), 0L);
+    KUNIT_EXPECT_NULL(test, theList);
+    KUNIT_EXPECT_EQ(test, do_init(MBX_TEST_PTRS, MBX_TEST_PROB), 0L);
+    KUNIT_EXPECT_EQ(test, t_create(1), 0L);
+}
+
+//every call before init or after shutdown used to oops in search()
+static void mbx_test_before_init(struct kunit* test){
+    do_shutdown();
+    KUNIT_EXPECT_NULL(test, search(1));
+    KUNIT_EXPECT_EQ(test, t_create(1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_destroy(1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_count(1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_length(1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_queue(1, 1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_acl_add(1, 1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_acl_remove(1, 1), (long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, t_set_ttl(1, 1), (long)-ENOENT);
+}
+
+//recv copied 8 bytes whatever the message size, leaked the message and read NULL when empty
+static void mbx_test_send_recv_user(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, PAGE_SIZE);
+    unsigned char kbuf[16];
+
+    KUNIT_ASSERT_EQ(test, t_create(3), 0L);
+    KUNIT_EXPECT_EQ(test, t_recv(3, ubuf, 64), (long)-EAGAIN);
+
+    KUNIT_ASSERT_EQ(test, copy_to_user(ubuf, "abc", 3), 0UL);
+    KUNIT_EXPECT_EQ(test, t_send(3, ubuf, 3), 0L);
+    KUNIT_EXPECT_EQ(test, t_length(3), 3L);
+    KUNIT_EXPECT_EQ(test, t_recv(3, ubuf + 64, 64), 3L);
+    KUNIT_ASSERT_EQ(test, copy_from_user(kbuf, ubuf + 64, 3), 0UL);
+    KUNIT_EXPECT_EQ(test, memcmp(kbuf, "abc", 3), 0);
+    KUNIT_EXPECT_EQ(test, t_recv(3, ubuf, 64), (long)-EAGAIN);
+
+    KUNIT_EXPECT_EQ(test, t_send(3, ubuf, 3), 0L);
+    KUNIT_EXPECT_EQ(test, t_recv(3, ubuf + 64, 2), 2L); // shorter buffer wins
+
+    KUNIT_EXPECT_EQ(test, t_send(3, ubuf, 3), 0L);
+    KUNIT_EXPECT_EQ(test, t_recv(3, (unsigned char __user *)16, 3), (long)-EFAULT);
+    KUNIT_EXPECT_EQ(test, t_count(3), 1L); // failed copy keeps the message
+}
+
+//send passed a failed kmalloc to copy_from_user, leaked on -EFAULT and took any len
+static void mbx_test_send_len(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, PAGE_SIZE);
+
+    KUNIT_ASSERT_EQ(test, t_create(4), 0L);
+    KUNIT_EXPECT_EQ(test, t_send(4, ubuf, 0), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, t_send(4, ubuf, -1), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, t_send(4, ubuf, MBX421_MSG_MAX + 1), (long)-EINVAL);
+    KUNIT_EXPECT_EQ(test, t_send(4, (unsigned char __user *)16, 8), (long)-EFAULT);
+    KUNIT_EXPECT_EQ(test, t_count(4), 0L);
+    KUNIT_EXPECT_EQ(test, t_recv(4, ubuf, 0), (long)-EINVAL);
+}
+
+//---ttl and the reaper---
+
+static void mbx_test_ttl_lazy(struct kunit* test){
+    int i;
+
+    KUNIT_ASSERT_EQ(test, t_create(11), 0L);
+    KUNIT_EXPECT_EQ(test, t_set_ttl(11, 1), 0L);
+    for(i = 0; i < 5; i++){
+        KUNIT_EXPECT_EQ(test, t_queue(11, i), 0L);
+    }
+    msleep(20);
+    KUNIT_EXPECT_EQ(test, t_count(11), 0L);
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_EQ(test, do_dropped(search(11)), 5L);
+    KUNIT_EXPECT_EQ(test, search(11)->mailBox->stamped, 0UL);
+    mutex_unlock(&mbx_lock);
+}
+
+//the reaper skipped mailboxes whose ttl had been set back to 0
+static void mbx_test_reaper_after_ttl_cleared(struct kunit* test){
+    int i;
+
+    KUNIT_ASSERT_EQ(test, t_create(12), 0L);
+    KUNIT_EXPECT_EQ(test, t_set_ttl(12, 1), 0L);
+    for(i = 0; i < 3; i++){
+        KUNIT_EXPECT_EQ(test, t_queue(12, i), 0L);
+    }
+    cancel_delayed_work_sync(&reap_work); // armed by the stamped sends, the test drives it by hand
+    KUNIT_EXPECT_EQ(test, t_set_ttl(12, 0), 0L);
+    msleep(20);
+
+    reap_slice(NULL);
+    cancel_delayed_work_sync(&reap_work);
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_EQ(test, search(12)->mailBox->dropped, 3UL); // read directly, do_dropped would expire lazily
+    KUNIT_EXPECT_EQ(test, search(12)->mailBox->stamped, 0UL);
+    mutex_unlock(&mbx_lock);
+}
+
+//a reaper run used to walk a whole queue however long it was
+static void mbx_test_reaper_budget(struct kunit* test){
+    fifo_queue_t* q;
+    int i;
+
+    KUNIT_ASSERT_EQ(test, t_create(13), 0L);
+    KUNIT_EXPECT_EQ(test, t_set_ttl(13, 1), 0L);
+    for(i = 0; i < 3 * MBX421_REAP_BUDGET; i++){
+        KUNIT_ASSERT_EQ(test, t_queue(13, i), 0L);
+    }
+    cancel_delayed_work_sync(&reap_work); // armed by the stamped sends, the test drives it by hand
+    msleep(20);
+
+    mutex_lock(&mbx_lock);
+    q = search(13)->mailBox;
+    mutex_unlock(&mbx_lock);
+    for(i = 1; i <= 3; i++){
+        reap_slice(NULL);
+        cancel_delayed_work_sync(&reap_work);
+        mutex_lock(&mbx_lock);
+        KUNIT_EXPECT_EQ(test, q->dropped, (unsigned long)(i * MBX421_REAP_BUDGET));
+        KUNIT_EXPECT_EQ(test, q->stamped, (unsigned long)((3 - i) * MBX421_REAP_BUDGET));
+        mutex_unlock(&mbx_lock);
+    }
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_NULL(test, q->front);
+    mutex_unlock(&mbx_lock);
+}
+
+//the reaper saved a link inside a queue and a recv could free the node holding it.
+//stamped messages in front of unstamped ones, the budget runs out among the unstamped
+//ones after every stamp is gone, so expireQ on recv no longer walked and reset reap_at
+static void mbx_test_reap_at_unstamped(struct kunit* test){
+    u32 tag;
+    int i;
+
+    KUNIT_ASSERT_EQ(test, t_create(14), 0L);
+    for(i = 0; i < MBX421_REAP_BUDGET + 10; i++){
+        KUNIT_ASSERT_EQ(test, t_queue(14, i), 0L); // unstamped, nearest the tail
+    }
+    KUNIT_EXPECT_EQ(test, t_set_ttl(14, 1), 0L);
+    for(i = 0; i < 5; i++){
+        KUNIT_ASSERT_EQ(test, t_queue(14, i), 0L); // stamped, at the front where the reaper starts
+    }
+    cancel_delayed_work_sync(&reap_work); // armed by the stamped sends, the test drives it by hand
+    msleep(20);
+
+    reap_slice(NULL);
+    cancel_delayed_work_sync(&reap_work);
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_EQ(test, search(14)->mailBox->dropped, 5UL);
+    KUNIT_EXPECT_EQ(test, search(14)->mailBox->stamped, 0UL);
+    KUNIT_EXPECT_NULL(test, search(14)->mailBox->reap_at); // nothing left to expire, nothing to resume
+    mutex_unlock(&mbx_lock);
+
+    for(i = 0; i < MBX421_REAP_BUDGET + 10; i++){
+        KUNIT_EXPECT_EQ(test, t_take(14, &tag), 0L);
+    }
+    KUNIT_EXPECT_EQ(test, t_queue(14, 1), 0L);
+    cancel_delayed_work_sync(&reap_work);
+    msleep(20);
+    reap_slice(NULL); // resuming through a freed node is a KASAN report here
+    cancel_delayed_work_sync(&reap_work);
+    KUNIT_EXPECT_EQ(test, t_count(14), 0L);
+}
+
+//same with every message stamped but none expired: the saved link sits in a node that
+//recv frees once the tail reaches it
+static void mbx_test_reap_at_recv(struct kunit* test){
+    u32 tag;
+    int i;
+
+    KUNIT_ASSERT_EQ(test, t_create(15), 0L);
+    KUNIT_EXPECT_EQ(test, t_set_ttl(15, 60000), 0L);
+    for(i = 0; i < MBX421_REAP_BUDGET + 20; i++){
+        KUNIT_ASSERT_EQ(test, t_queue(15, i), 0L);
+    }
+    cancel_delayed_work_sync(&reap_work);
+
+    reap_slice(NULL);
+    cancel_delayed_work_sync(&reap_work);
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_NOT_NULL(test, search(15)->mailBox->reap_at); // stopped inside the queue
+    mutex_unlock(&mbx_lock);
+
+    for(i = 0; i < 21; i++){ // the 21st frees the node the link was saved in
+        KUNIT_EXPECT_EQ(test, t_take(15, &tag), 0L);
+    }
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_NULL(test, search(15)->mailBox->reap_at);
+    mutex_unlock(&mbx_lock);
+
+    KUNIT_EXPECT_EQ(test, t_queue(15, 1), 0L);
+    cancel_delayed_work_sync(&reap_work);
+    reap_slice(NULL);
+    cancel_delayed_work_sync(&reap_work);
+    KUNIT_EXPECT_EQ(test, t_count(15), (long)MBX421_REAP_BUDGET);
+}
+
+//the reaper used to re-arm every period forever, even with nothing that could expire
+static void mbx_test_reaper_disarms(struct kunit* test){
+    KUNIT_ASSERT_EQ(test, t_create(16), 0L);
+    KUNIT_EXPECT_EQ(test, t_queue(16, 1), 0L);
+    KUNIT_EXPECT_FALSE(test, delayed_work_pending(&reap_work)); // unstamped, nothing to arm for
+
+    KUNIT_EXPECT_EQ(test, t_set_ttl(16, 1), 0L);
+    KUNIT_EXPECT_EQ(test, t_queue(16, 2), 0L);
+    KUNIT_EXPECT_TRUE(test, delayed_work_pending(&reap_work));
+    cancel_delayed_work_sync(&reap_work);
+    msleep(20);
+
+    reap_slice(NULL);
+    KUNIT_EXPECT_FALSE(test, delayed_work_pending(&reap_work)); // the only stamped message is gone
+    mutex_lock(&mbx_lock);
+    KUNIT_EXPECT_EQ(test, stamped_total, 0UL);
+    KUNIT_EXPECT_EQ(test, search(16)->mailBox->dropped, 1UL);
+    mutex_unlock(&mbx_lock);
+    KUNIT_EXPECT_EQ(test, t_count(16), 1L);
+}
+
+//---mbx421_submit---
+
+static void mbx_test_submit_order(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, PAGE_SIZE);
+    mbx421_sqe_t sq[10];
+    mbx421_cqe_t cq[10];
+    int i;
+
+    KUNIT_ASSERT_EQ(test, copy_to_user(ubuf, "hello", 5), 0UL);
+    memset(sq, 0, sizeof(sq));
+    //interleaved ids 30 and 20, each with its own create, send, recv, destroy
+    sq[0] = (mbx421_sqe_t){ .opcode = MBX421_OP_CREATE, .id = 30 };
+    sq[1] = (mbx421_sqe_t){ .opcode = MBX421_OP_CREATE, .id = 20 };
+    sq[2] = (mbx421_sqe_t){ .opcode = MBX421_OP_SEND, .id = 30, .msg = (__u64)(unsigned long)ubuf, .len = 5 };
+    sq[3] = (mbx421_sqe_t){ .opcode = MBX421_OP_SEND, .id = 20, .msg = (__u64)(unsigned long)ubuf, .len = 2 };
+    sq[4] = (mbx421_sqe_t){ .opcode = MBX421_OP_RECV, .id = 30, .msg = (__u64)(unsigned long)(ubuf + 64), .len = 64 };
+    sq[5] = (mbx421_sqe_t){ .opcode = MBX421_OP_DESTROY, .id = 20 };
+    sq[6] = (mbx421_sqe_t){ .opcode = MBX421_OP_RECV, .id = 20, .msg = (__u64)(unsigned long)(ubuf + 64), .len = 64 };
+    sq[7] = (mbx421_sqe_t){ .opcode = MBX421_OP_DESTROY, .id = 99 };
+    sq[8] = (mbx421_sqe_t){ .opcode = MBX421_OP_ACL_ADD, .id = 30, .process_id = 1 };
+    sq[9] = (mbx421_sqe_t){ .opcode = 77, .id = 30 };
+    for(i = 0; i < 10; i++){
+        sq[i].user_data = 1000 + i;
+    }
+
+    KUNIT_EXPECT_EQ(test, run_batch(sq, cq, 10), 0L);
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    mutex_unlock(&mbx_lock);
+
+    for(i = 0; i < 10; i++){
+        KUNIT_EXPECT_EQ(test, cq[i].user_data, (__u64)(1000 + i));
+    }
+    KUNIT_EXPECT_EQ(test, cq[0].res, 0LL);
+    KUNIT_EXPECT_EQ(test, cq[1].res, 0LL);
+    KUNIT_EXPECT_EQ(test, cq[2].res, 0LL);
+    KUNIT_EXPECT_EQ(test, cq[3].res, 0LL);
+    KUNIT_EXPECT_EQ(test, cq[4].res, 5LL);
+    KUNIT_EXPECT_EQ(test, cq[5].res, 0LL);
+    KUNIT_EXPECT_EQ(test, cq[6].res, (long long)-ENOENT); // destroyed just before, per id order kept
+    KUNIT_EXPECT_EQ(test, cq[7].res, (long long)-ENOENT);
+    KUNIT_EXPECT_EQ(test, cq[8].res, 0LL);
+    KUNIT_EXPECT_EQ(test, cq[9].res, (long long)-EINVAL);
+}
+
+//send payloads of one batch are capped, the whole batch is refused before anything is copied
+static void mbx_test_submit_bytes(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, MBX421_MSG_MAX);
+    unsigned int nr = MBX421_SUBMIT_BYTES / MBX421_MSG_MAX + 1;
+    mbx421_sqe_t* sq = kunit_kcalloc(test, nr, sizeof(mbx421_sqe_t), GFP_KERNEL);
+    mbx421_cqe_t* cq = kunit_kcalloc(test, nr, sizeof(mbx421_cqe_t), GFP_KERNEL);
+    unsigned int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, sq);
+    KUNIT_ASSERT_NOT_NULL(test, cq);
+    for(i = 0; i < nr; i++){
+        sq[i] = (mbx421_sqe_t){ .opcode = MBX421_OP_SEND, .id = 40, .msg = (__u64)(unsigned long)ubuf, .len = MBX421_MSG_MAX };
+    }
+    KUNIT_EXPECT_EQ(test, run_batch(sq, cq, nr), (long)-E2BIG);
+    KUNIT_EXPECT_EQ(test, t_count(40), (long)-ENOENT); // the send would have created it
+
+    KUNIT_EXPECT_EQ(test, run_batch(sq, cq, nr - 1), 0L); // exactly at the cap is fine
+    KUNIT_EXPECT_EQ(test, t_count(40), (long)(nr - 1));
+}
+
+//a batch longer than one chunk drops mbx_lock in between and must keep per id order across it
+static void mbx_test_submit_chunks(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, PAGE_SIZE);
+    unsigned int nr = 2 * MBX421_SUBMIT_CHUNK + 2;
+    mbx421_sqe_t* sq = kunit_kcalloc(test, nr, sizeof(mbx421_sqe_t), GFP_KERNEL);
+    mbx421_cqe_t* cq = kunit_kcalloc(test, nr, sizeof(mbx421_cqe_t), GFP_KERNEL);
+    unsigned int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, sq);
+    KUNIT_ASSERT_NOT_NULL(test, cq);
+    sq[0] = (mbx421_sqe_t){ .opcode = MBX421_OP_CREATE, .id = 41 };
+    for(i = 1; i < nr - 1; i++){
+        sq[i] = (mbx421_sqe_t){ .opcode = MBX421_OP_SEND, .id = 41, .msg = (__u64)(unsigned long)ubuf, .len = 4 };
+    }
+    sq[nr - 1] = (mbx421_sqe_t){ .opcode = MBX421_OP_DESTROY, .id = 41 }; // in the last chunk, after every send
+    KUNIT_EXPECT_EQ(test, run_batch(sq, cq, nr), 0L);
+    for(i = 0; i < nr; i++){
+        KUNIT_EXPECT_EQ(test, cq[i].res, 0LL);
+    }
+    KUNIT_EXPECT_EQ(test, t_count(41), (long)-ENOENT);
+    mutex_lock(&mbx_lock);
+    check_skip_list(test);
+    mutex_unlock(&mbx_lock);
+}
+
+//finger search must agree with search() for every id, present or not
+static void mbx_test_finger_search(struct kunit* test){
+    sl_node* finger[MBX421_MAX_PTRS + 1];
+    unsigned long id;
+    int i;
+
+    for(i = 0; i < 300; i++){
+        t_create(1 + get_random_u32_below(MBX_TEST_IDS));
+    }
+    mutex_lock(&mbx_lock);
+    reset_finger(finger);
+    for(id = 0; id <= MBX_TEST_IDS + 1; id++){
+        KUNIT_EXPECT_PTR_EQ(test, search_finger(id, finger), search(id));
+    }
+    KUNIT_EXPECT_NULL(test, search_finger(ULONG_MAX, finger));
+    mutex_unlock(&mbx_lock);
+}
+
+static struct kunit_case mbx_test_cases[] = {
+    KUNIT_CASE(mbx_test_skip_list_random),
+    KUNIT_CASE(mbx_test_queue_random),
+    KUNIT_CASE(mbx_test_acl_random),
+    KUNIT_CASE(mbx_test_concurrent_stress),
+    KUNIT_CASE(mbx_test_killq_keeps_queue),
+    KUNIT_CASE(mbx_test_killacl_keeps_list),
+    KUNIT_CASE(mbx_test_maxnumber),
+    KUNIT_CASE(mbx_test_head_sentinel),
+    KUNIT_CASE(mbx_test_acl_permission),
+    KUNIT_CASE(mbx_test_length_null_acl),
+    KUNIT_CASE(mbx_test_getlevel_bound),
+    KUNIT_CASE(mbx_test_init_bounds),
+    KUNIT_CASE(mbx_test_killall),
+    KUNIT_CASE(mbx_test_before_init),
+    KUNIT_CASE(mbx_test_send_recv_user),
+    KUNIT_CASE(mbx_test_send_len),
+    KUNIT_CASE(mbx_test_ttl_lazy),
+    KUNIT_CASE(mbx_test_reaper_after_ttl_cleared),
+    KUNIT_CASE(mbx_test_reaper_budget),
+    KUNIT_CASE(mbx_test_reap_at_unstamped),
+    KUNIT_CASE(mbx_test_reap_at_recv),
+    KUNIT_CASE(mbx_test_reaper_disarms),
+    KUNIT_CASE(mbx_test_submit_order),
+    KUNIT_CASE(mbx_test_submit_bytes),
+    KUNIT_CASE(mbx_test_submit_chunks),
+    KUNIT_CASE(mbx_test_finger_search),
+    {}
+};
+
+static struct kunit_suite mbx_test_suite = {
+    .name = "mbx421",
+    .init = mbx_test_init,
+    .exit = mbx_test_exit,
+    .test_cases = mbx_test_cases,
+};
+
+//---benchmarks, ns/op in the test log, compare runs before and after a change---
+
+#define MBX_BENCH_BOXES 4096
+#define MBX_BENCH_OPS 100000
+
+static u64 bench_start(void){
+    return ktime_get_ns();
+}
+
+static void bench_report(struct kunit* test, const char* what, u64 start, unsigned long ops){
+    u64 ns = ktime_get_ns() - start;
+    kunit_info(test, "%s: %llu ns/op (%lu ops)\n", what, div_u64(ns, ops), ops);
+}
+
+static void mbx_bench_fill(struct kunit* test){
+    unsigned long id;
+    for(id = 1; id <= MBX_BENCH_BOXES; id++){
+        KUNIT_ASSERT_EQ(test, t_create(id), 0L);
+    }
+}
+
+static void mbx_bench_search(struct kunit* test){
+    sl_node* volatile sink;
+    u64 start;
+    int i;
+
+    mbx_bench_fill(test);
+    mutex_lock(&mbx_lock);
+    start = bench_start();
+    for(i = 0; i < MBX_BENCH_OPS; i++){
+        sink = search(1 + get_random_u32_below(MBX_BENCH_BOXES));
+    }
+    bench_report(test, "search hit, 4096 mailboxes", start, MBX_BENCH_OPS);
+    mutex_unlock(&mbx_lock);
+    (void)sink;
+}
+
+static void mbx_bench_create_destroy(struct kunit* test){
+    u64 start;
+    int i;
+
+    mbx_bench_fill(test);
+    start = bench_start();
+    for(i = 0; i < MBX_BENCH_OPS / 10; i++){
+        unsigned long id = MBX_BENCH_BOXES + 1 + get_random_u32_below(MBX_BENCH_BOXES);
+        t_create(id);
+        t_destroy(id);
+    }
+    bench_report(test, "create+destroy", start, MBX_BENCH_OPS / 10);
+}
+
+static void mbx_bench_send_recv(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, PAGE_SIZE);
+    u64 start;
+    int i;
+
+    mbx_bench_fill(test);
+    start = bench_start();
+    for(i = 0; i < MBX_BENCH_OPS / 10; i++){
+        unsigned long id = 1 + get_random_u32_below(MBX_BENCH_BOXES);
+        KUNIT_ASSERT_EQ(test, t_send(id, ubuf, 64), 0L);
+        KUNIT_ASSERT_EQ(test, t_recv(id, ubuf + 128, 64), 64L);
+    }
+    bench_report(test, "send+recv 64 bytes, single calls", start, MBX_BENCH_OPS / 10);
+}
+
+static void mbx_bench_submit(struct kunit* test){
+    unsigned char __user * ubuf = t_user_buf(test, PAGE_SIZE);
+    mbx421_sqe_t* sq = kunit_kcalloc(test, 1024, sizeof(mbx421_sqe_t), GFP_KERNEL);
+    mbx421_cqe_t* cq = kunit_kcalloc(test, 1024, sizeof(mbx421_cqe_t), GFP_KERNEL);
+    u64 start;
+    int i, round;
+
+    KUNIT_ASSERT_NOT_NULL(test, sq);
+    KUNIT_ASSERT_NOT_NULL(test, cq);
+    mbx_bench_fill(test);
+    for(i = 0; i < 1024; i += 2){ // send and recv pairs on interleaved ids
+        unsigned long id = 1 + get_random_u32_below(MBX_BENCH_BOXES);
+        sq[i] = (mbx421_sqe_t){ .opcode = MBX421_OP_SEND, .id = id, .msg = (__u64)(unsigned long)ubuf, .len = 64 };
+        sq[i + 1] = (mbx421_sqe_t){ .opcode = MBX421_OP_RECV, .id = id, .msg = (__u64)(unsigned long)(ubuf + 128), .len = 64 };
+    }
+
+    start = bench_start();
+    for(round = 0; round < 10; round++){
+        KUNIT_ASSERT_EQ(test, run_batch(sq, cq, 1024), 0L);
+    }
+    bench_report(test, "submit batch of 1024 send/recv", start, 10 * 1024);
+    for(i = 0; i < 1024; i++){
+        KUNIT_EXPECT_EQ(test, cq[i].res, (i % 2) ? 64LL : 0LL);
+    }
+}
+
+static void mbx_bench_reaper(struct kunit* test){
+    u64 start;
+    unsigned long runs = 0;
+    int i;
+
+    KUNIT_ASSERT_EQ(test, t_create(1), 0L);
+    KUNIT_EXPECT_EQ(test, t_set_ttl(1, 1), 0L);
+    for(i = 0; i < 16 * MBX421_REAP_BUDGET; i++){
+        KUNIT_ASSERT_EQ(test, t_queue(1, i), 0L);
+    }
+    cancel_delayed_work_sync(&reap_work);
+    msleep(20);
+
+    start = bench_start();
+    mutex_lock(&mbx_lock); // read stamped directly, count would expire everything lazily in one go
+    while(search(1)->mailBox->stamped != 0 && runs < 1000){
+        mutex_unlock(&mbx_lock);
+        reap_slice(NULL);
+        cancel_delayed_work_sync(&reap_work);
+        runs++;
+        mutex_lock(&mbx_lock);
+    }
+    mutex_unlock(&mbx_lock);
+    bench_report(test, "reaper run", start, runs ? runs : 1);
+}
+
+static struct kunit_case mbx_bench_cases[] = {
+    KUNIT_CASE_SLOW(mbx_bench_search),
+    KUNIT_CASE_SLOW(mbx_bench_create_destroy),
+    KUNIT_CASE_SLOW(mbx_bench_send_recv),
+    KUNIT_CASE_SLOW(mbx_bench_submit),
+    KUNIT_CASE_SLOW(mbx_bench_reaper),
+    {}
+};
+
+static struct kunit_suite mbx_bench_suite = {
+    .name = "mbx421_bench",
+    .init = mbx_test_init,
+    .exit = mbx_test_exit,
+    .test_cases = mbx_bench_cases,
+};
+
+kunit_test_suites(&mbx_test_suite, &mbx_bench_suite);
+
+//=====================//
+//====End KUnitTests===//
+//=====================//
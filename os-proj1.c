@@ -9,33 +9,47 @@
 #include "linux/uidgid.h"
 #include <linux/slab.h>
 #include <linux/rwlock.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/mm.h>
+#include <linux/sort.h>
+#include "mbx421.h"
 
 //=====================//
 //===Start_fifo_queue==//
 //=====================//
 typedef struct q_node{
 
-    unsigned long data;
+    unsigned long data; // kmalloc'd copy of the message
+
+    long len; // bytes in data
+
+    unsigned long expires; // jiffies after which the message is dropped, 0 never expires
 
     struct q_node* nextNode;
 
 } q_node_t;
 
-void enqueue(q_node_t** front, unsigned long new_data){
+int enqueue(q_node_t** front, unsigned long new_data, long len, unsigned long expires){
 
     q_node_t* newNode = kmalloc(sizeof(q_node_t),GFP_KERNEL);
     if(!newNode){
         printk("\nmymessege:: enqueue newNode, kmalloc failure\n");
-        return;
+        return -ENOMEM;
     }
 
     newNode->data = new_data;
+    newNode->len = len;
+    newNode->expires = expires;
     newNode->nextNode = *front;
 
     *front = newNode;
+    return 0;
 }
 
-unsigned long dequeue(q_node_t **front) {
+//unlinks the oldest message and hands the node to the caller, who frees it
+q_node_t* dequeue(q_node_t **front) {
     q_node_t *temp = *front;
     q_node_t *prev = 0;
 
@@ -47,15 +61,12 @@ unsigned long dequeue(q_node_t **front) {
         temp = temp->nextNode;
     }
 
-    unsigned long returnValue = temp->data;
-    kfree(temp);
-
     if (prev)
         prev->nextNode = 0;
     else
         *front = 0;
 
-    return returnValue;
+    return temp;
 }
 
 long dumpQ(q_node_t* front){
@@ -70,9 +81,36 @@ long dumpQ(q_node_t* front){
     return count;
 }
 
+//unlinks and frees expired messages starting at the link *at, looking at no more than *budget messages.
+//*at is left where the walk stopped, or 0 once it reached the end. returns how many were dropped
+long reapQ(q_node_t*** at, unsigned long now, long* budget){
+    long dropped = 0;
+    q_node_t** link = *at;
+
+    while(*link != 0 && *budget > 0){
+        q_node_t* temp = *link;
+        (*budget)--;
+        if(temp->expires != 0 && time_after_eq(now, temp->expires)){
+            *link = temp->nextNode;
+            kfree((void*)temp->data); // nobody will recv it, free the copied message too
+            kfree(temp);
+            dropped++;
+            continue;
+        }
+        link = &temp->nextNode;
+    }
+    *at = (*link == 0) ? 0 : link;
+    return dropped;
+}
+
 void killQ(q_node_t** front){
-    while(dequeue(front) != 0);
-    kfree(front);
+    q_node_t* temp = *front;
+    while(temp != 0){ // front to back in one walk, dequeue would walk to the tail for every message
+        q_node_t* next = temp->nextNode;
+        kfree((void*)temp->data); // free the copied message, front itself lives inside the fifo_queue_t
+        kfree(temp);
+        temp = next;
+    }
     *front = 0;
 }
 
@@ -80,35 +118,135 @@ typedef struct fifo_queue{
 
     q_node_t* front;
 
-    void (*enqueue)(q_node_t** Front, unsigned long data);
+    unsigned long ttl; // time to live in jiffies given to new messages, 0 keeps them forever
+
+    unsigned long dropped; // messages reaped after expiring
+
+    unsigned long stamped; // queued messages with an expiry stamp, 0 means nothing here can expire
 
-    unsigned long (*dequeue)(q_node_t** mailboxQ);
+    q_node_t** reap_at; // link the background reaper resumes from, 0 starts at front
+
+    int (*enqueue)(q_node_t** Front, unsigned long data, long len, unsigned long expires);
+
+    q_node_t* (*dequeue)(q_node_t** mailboxQ);
 
     long (*dumpQ)(q_node_t* mailboxQ);
 
     void (*killQ)(q_node_t** front);
 
+    long (*reapQ)(q_node_t*** at, unsigned long now, long* budget);
+
 }fifo_queue_t;
 
-fifo_queue_t* createQ(void (*enqueue)(q_node_t** Front, unsigned long data), unsigned long(*dequeue)(q_node_t** mailboxQ),long (*dumpQ)(q_node_t* mailboxQ),void (*killQ)(q_node_t** front)){
+fifo_queue_t* createQ(int (*enqueue)(q_node_t** Front, unsigned long data, long len, unsigned long expires), q_node_t*(*dequeue)(q_node_t** mailboxQ),long (*dumpQ)(q_node_t* mailboxQ),void (*killQ)(q_node_t** front),long (*reapQ)(q_node_t*** at, unsigned long now, long* budget)){
     fifo_queue_t* q = (fifo_queue_t*)kmalloc(sizeof(fifo_queue_t),GFP_KERNEL);
     if(!q){
         printk("\nmymessege:: createQ q, kmalloc failure\n");
         return 0;
     }
     q->front = 0;
+    q->ttl = 0;
+    q->dropped = 0;
+    q->stamped = 0;
+    q->reap_at = 0;
     q->enqueue = enqueue;
     q->dequeue = dequeue;
     q->dumpQ = dumpQ;
     q->killQ = killQ;
+    q->reapQ = reapQ;
 
     return q;
 }
 
+//expiry stamp for a message enqueued now
+static unsigned long expiresQ(fifo_queue_t* q){
+    if(q->ttl == 0) return 0;
+    unsigned long expires = jiffies + q->ttl;
+    return expires ? expires : 1; // 0 is reserved for never
+}
+
+static unsigned long stamped_total = 0; // stamped messages over all mailboxes, the reaper only runs while this is not 0
+
+static void arm_reaper(void); // in the Reaper section
+
+//enqueue stamped with the mailbox ttl, keeps the stamped counts in step
+static int sendQ(fifo_queue_t* q, unsigned long data, long len){
+    unsigned long expires = expiresQ(q);
+    int ret = q->enqueue(&q->front, data, len, expires);
+    if(ret == 0 && expires != 0){
+        q->stamped++;
+        stamped_total++;
+        arm_reaper();
+    }
+    return ret;
+}
+
+//dequeue that keeps the stamped counts in step, caller frees the node
+static q_node_t* recvQ(fifo_queue_t* q){
+    q_node_t* temp = q->dequeue(&q->front);
+    if(temp != 0 && temp->expires != 0){
+        q->stamped--;
+        stamped_total--;
+    }
+    q->reap_at = 0; // the tail moves as messages are received, the saved link may sit in the node just freed
+    return temp;
+}
+
+//puts a node recvQ handed out back as the oldest message, for when the copy to the user failed
+static void unrecvQ(fifo_queue_t* q, q_node_t* node){
+    q_node_t** link = &q->front;
+    while(*link != 0){
+        link = &(*link)->nextNode;
+    }
+    node->nextNode = 0;
+    *link = node;
+    if(node->expires != 0){
+        q->stamped++;
+        stamped_total++;
+        arm_reaper();
+    }
+}
+
+//the message recvQ would hand out next, 0 when the queue is empty
+static q_node_t* peekQ(fifo_queue_t* q){
+    q_node_t* temp = q->front;
+    if(temp == 0) return 0;
+    while(temp->nextNode != 0){
+        temp = temp->nextNode;
+    }
+    return temp;
+}
+
+//lazy expiry, drop whatever has gone stale before the queue is read
+static void expireQ(fifo_queue_t* q){
+    if(q->stamped == 0) return; // nothing can expire, skip the walk
+    q_node_t** at = &q->front;
+    long budget = LONG_MAX;
+    long dropped = q->reapQ(&at, jiffies, &budget);
+    q->dropped += dropped;
+    q->stamped -= dropped;
+    stamped_total -= dropped;
+    q->reap_at = 0; // the walk may have freed the node the reaper was resuming from
+}
+
+//one budgeted step of background expiry, returns 1 once the whole queue has been walked
+static int reapStepQ(fifo_queue_t* q, long* budget){
+    q_node_t** at = q->reap_at ? q->reap_at : &q->front;
+    long dropped = q->reapQ(&at, jiffies, budget);
+    q->dropped += dropped;
+    q->stamped -= dropped;
+    stamped_total -= dropped;
+    if(q->stamped == 0){
+        at = 0; // nothing left that can expire, done with this queue
+    }
+    q->reap_at = at; // recvQ and expireQ clear it, they are the only other places nodes are freed
+    return at == 0;
+}
+
 //    fifo_queue_t* mailboxQ;
-//    mailboxQ = createQ(enqueue, dequeue, dumpQ);
-//    mailboxQ->enqueue(&mailboxQ->front,5);
-//    printk("getFront_and_dequeue = %lu\n", mailboxQ->dequeue(&mailboxQ->front));
+//    mailboxQ = createQ(enqueue, dequeue, dumpQ, killQ, reapQ);
+//    sendQ(mailboxQ,(unsigned long)msg,len);
+//    printk("getFront_and_dequeue = %lu\n", recvQ(mailboxQ)->data);
 //    mailboxQ->dumpQ(mailboxQ->front);
 
 
@@ -127,19 +265,19 @@ typedef struct ACL_node {
 
 }ACL_node_t;
 
-static void insert_ACL_node(ACL_node_t** h, pid_t allowedid){
+static int insert_ACL_node(ACL_node_t** h, pid_t allowedid){
 
     //insert to head of LL
     ACL_node_t* link = kmalloc(sizeof(ACL_node_t),GFP_KERNEL);
     if(link == 0){
         printk("\nmymessege:: insert_ACL_node link, kmalloc failure\n");
-        return;
+        return -ENOMEM;
     }else{
         link->allowedID = allowedid;
         link->nextNode = *h;
         *h = link;
     }
-
+    return 0;
 }
 static int checkExist(ACL_node_t** h, pid_t allowedid){
     ACL_node_t* temp = *h;
@@ -186,20 +324,19 @@ void killACL(ACL_node_t** h){
         temp = temp->nextNode;
         kfree(prev);
     }
-    kfree(temp);
-    kfree(h);
+    *h = 0; // h points into the ACL_LIST_T, the caller frees that
 }
 
 typedef struct ACL_LIST{
     ACL_node_t* h;
     void (*killACL)(ACL_node_t** h);
-    void (*insert_ACL_node)(ACL_node_t** h,pid_t allowedid);
+    int (*insert_ACL_node)(ACL_node_t** h,pid_t allowedid);
     int (*checkExist)(ACL_node_t** h,pid_t allowedid);
     int (*deleteAllowedID)(ACL_node_t** h,pid_t deleteid);
     void (*dumpList)(ACL_node_t* h);
 }ACL_LIST_T;
 
-ACL_LIST_T* createACL(void (*killACL)(ACL_node_t** h),void (*insert_ACL_node)(ACL_node_t** h,pid_t allowedid),int (*checkExist)(ACL_node_t** h,pid_t allowedid),int (*deleteAllowedID)(ACL_node_t** h,pid_t deleteid),void(*dumpList)(ACL_node_t* h)){
+ACL_LIST_T* createACL(void (*killACL)(ACL_node_t** h),int (*insert_ACL_node)(ACL_node_t** h,pid_t allowedid),int (*checkExist)(ACL_node_t** h,pid_t allowedid),int (*deleteAllowedID)(ACL_node_t** h,pid_t deleteid),void(*dumpList)(ACL_node_t* h)){
     ACL_LIST_T* ACL = (ACL_LIST_T*)kmalloc(sizeof(ACL_LIST_T),GFP_KERNEL);
     if(ACL == 0){
         printk("\nmymessege:: createACL ACL, kmalloc failure\n");
@@ -229,11 +366,13 @@ ACL_LIST_T* createACL(void (*killACL)(ACL_node_t** h),void (*insert_ACL_node)(AC
 //=====================//
 //===Start_SkipList====//
 //=====================//
+#define MBX421_MAX_PTRS 32 // cap on mbx421_init ptrs, update vectors live on the stack
+
 unsigned int MAX_LEVEL;
 
 unsigned int PROBABILITY;
 
-unsigned long MAXNUMBER = (2^63)-1;
+unsigned long MAXNUMBER = ULONG_MAX; // id of the head node, sorts after every mailbox id
 
 static unsigned int next_random = 423534345;
 
@@ -248,7 +387,7 @@ static unsigned int getLevel(void){
 
     unsigned int rand_int = generate_random_int();
 
-    while(rand_int <= (32768/PROBABILITY) && level <= MAX_LEVEL){
+    while(rand_int <= (32768/PROBABILITY) && level < MAX_LEVEL){ // forwardNodes only go up to index MAX_LEVEL
         level++;
         rand_int = generate_random_int();
     }
@@ -278,26 +417,56 @@ typedef struct skip_list {
 
 skip_list_t* theList;
 
+static sl_node* search(unsigned long search_id);
+
+//frees a node that is not linked into the list (or no longer is)
+static void free_sl_node(sl_node* n){
+    if(n->mailBox != 0){
+        stamped_total -= n->mailBox->stamped;
+        n->mailBox->killQ(&n->mailBox->front);
+        kfree(n->mailBox);
+    }
+    if(n->ACL != 0){
+        n->ACL->killACL(&n->ACL->h);
+        kfree(n->ACL);
+    }
+    kfree(n->forwardNodes);
+    kfree(n);
+}
+
+//node with an empty mailbox and room for levels 1..level, 0 on kmalloc failure
+static sl_node* new_sl_node(unsigned long id, unsigned int level){
+    sl_node* n = (sl_node*)kmalloc(sizeof(sl_node),GFP_KERNEL);
+    if(!n){
+        printk("\nmymessege:: new_sl_node n, kmalloc failure\n");
+        return 0;
+    }
+    n->id = id;
+    n->ACL = 0;
+    n->mailBox = createQ(enqueue, dequeue, dumpQ, killQ, reapQ);
+    n->forwardNodes = (sl_node**)kmalloc_array((level+1), sizeof(sl_node*), GFP_KERNEL);
+    if(!n->mailBox || !n->forwardNodes){
+        printk("\nmymessege:: new_sl_node, kmalloc failure\n");
+        free_sl_node(n);
+        return 0;
+    }
+    return n;
+}
+
 static int skip_list_init(void) {
 
     theList = (skip_list_t*)kmalloc(sizeof(skip_list_t),GFP_KERNEL);
     if(!theList){
         printk("\nmymessege:: skip_list_init theList, kmalloc failure\n");
-        return -1;
+        return -ENOMEM;
     }
 
-    sl_node* ahead = (sl_node*)kmalloc(sizeof(sl_node),GFP_KERNEL); //allocate mem for head node
+    sl_node* ahead = new_sl_node(MAXNUMBER, MAX_LEVEL); //head node, id int max so that it cannot be replaced
     if(!ahead){
         printk("\nmymessege:: skip_list_init ahead, kmalloc failure\n");
-        return -1;
-    }
-    theList->head = ahead;
-    ahead->id = MAXNUMBER; //initialize to int max so that it cannot be replaced
-    ahead->mailBox = createQ(enqueue, dequeue, dumpQ, killQ);
-    ahead->forwardNodes = (sl_node**)kmalloc((MAX_LEVEL+1) * sizeof(sl_node*),GFP_KERNEL); // allocate mem for the nodes forwardnodel list of node pointers
-    if(!ahead->forwardNodes){
-        printk("\nsmymessege:: kip_list_init ahead->forwardNodes, kmalloc failure\n");
-        return -1;
+        kfree(theList);
+        theList = 0;
+        return -ENOMEM;
     }
     theList->head = ahead;
     unsigned int i;
@@ -306,144 +475,138 @@ static int skip_list_init(void) {
     }
     theList->level = 1;
 
-    printk("\nmymessege:: skip list init made it to 320\n");
     return 0;
 
 };
 
-static void insert(unsigned long insert_id, unsigned long insert_mailbox_data) {
+//adds an empty mailbox, returns its node or 0 on kmalloc failure
+static sl_node* create_mb_empty(unsigned long insert_id) {
 
     unsigned int assign_level;
 
-    //sl_node *updateSpot[MAX_LEVEL + 1];
-
-    sl_node **updateSpot = (sl_node**)kmalloc_array((MAX_LEVEL+1),sizeof(sl_node*), GFP_KERNEL);
+    sl_node* updateSpot[MBX421_MAX_PTRS + 1];
 
     sl_node *n = theList->head;
-
-
-
     unsigned int i;
     for (i = theList->level; i >= 1; i--) {
-        //printk("comapiring n->forwardNodes[%lu]->id(%lu)  < insert_id(%lu)\n", i, n->forwardNodes[i]->id, insert_id);
-        while (n->forwardNodes[i]->id < insert_id) {
-            //printk("its less than so moving into forwardnodes\n");
+        while (n->forwardNodes[i] != theList->head && n->forwardNodes[i]->id < insert_id) {
             n = n->forwardNodes[i];
         }
-        //printk("its greater than or = to, so adding note to update list at this level\n");
         updateSpot[i] = n;
     }
-    n = n->forwardNodes[1];
 
-    if (n->id == insert_id) {
-        n->mailBox->enqueue(&n->mailBox->front, insert_mailbox_data); //if this spot in the skip list already exists just replace its data with given
-        return;
-    } else { // else create a new node to hold the data, coin toss how many levels to assign its forwardNodes
-        assign_level = getLevel();
-
-        if (assign_level > theList->level) { //make sure the list header reaches to highest level
-            for (i = theList->level + 1; i <= assign_level; i++) {
-                updateSpot[i] = theList->head;
-            }
-            theList->level = assign_level;
-        }
+    assign_level = getLevel();
 
-        n = (sl_node *) kmalloc(sizeof(sl_node),GFP_KERNEL);
-        n->id = insert_id;
-        n->mailBox = createQ(enqueue, dequeue, dumpQ, killQ);
-        n->mailBox->enqueue(&n->mailBox->front, insert_mailbox_data);
-        n->forwardNodes = (sl_node **) kmalloc((assign_level + 1) * sizeof(sl_node *),GFP_KERNEL);
+    n = new_sl_node(insert_id, assign_level);
+    if(!n){
+        printk("\nmymessege:: create_mb_empty n, kmalloc failure\n");
+        return 0;
+    }
 
-        for (i = 1; i <= assign_level; i++) {  // update all assigned levels with the info
-            n->forwardNodes[i] = updateSpot[i]->forwardNodes[i];
-            updateSpot[i]->forwardNodes[i] = n;
+    if (assign_level > theList->level) { //make sure the list header reaches to highest level
+        for (i = theList->level + 1; i <= assign_level; i++) {
+            updateSpot[i] = theList->head;
         }
+        theList->level = assign_level;
+    }
+
+    for (i = 1; i <= assign_level; i++) {  // update all assigned levels with the info
+        n->forwardNodes[i] = updateSpot[i]->forwardNodes[i];
+        updateSpot[i]->forwardNodes[i] = n;
     }
+    return n;
 }
-static void create_mb_empty(unsigned long insert_id) {
 
-    unsigned int assign_level;
+//queues an already copied message, creating the mailbox if it does not exist yet.
+//takes ownership of the message only on success
+static long insert(unsigned long insert_id, unsigned long insert_mailbox_data, long len) {
 
-    sl_node **updateSpot = (sl_node**)kmalloc_array((MAX_LEVEL+1), sizeof(sl_node*), GFP_KERNEL);
+    if(insert_id == 0 || insert_id == MAXNUMBER) return -EINVAL; //would create a mailbox with an invalid id
 
-    printk("\nmymessege:: creat_mb_empty made it to 380\n");
+    sl_node* n = search(insert_id);
 
-    sl_node *n = theList->head;
-    unsigned int i;
-    for (i = theList->level; i >= 1; i--) {
-        while (n->forwardNodes[i]->id < insert_id) {
-            n = n->forwardNodes[i];
-        }
-        updateSpot[i] = n;
+    if (n == 0) { // create a new node to hold the data, coin toss how many levels to assign its forwardNodes
+        n = create_mb_empty(insert_id);
+        if (n == 0) return -ENOMEM;
     }
-    printk("\nmymessege:: creat_mb_empty made it to 390\n");
+    return sendQ(n->mailBox, insert_mailbox_data, len);
+}
 
-    assign_level = getLevel();
+static sl_node* search(unsigned long search_id){
 
-    if (assign_level > theList->level) { //make sure the list header reaches to highest level
-        for (i = theList->level + 1; i <= assign_level; i++) {
-            updateSpot[i] = theList->head;
+    if(theList == 0) return 0; // mbx421_init not called yet, or shut down
+
+    sl_node* n = theList->head;
+    unsigned int i;
+    for(i = theList->level; i >= 1; i--){
+        while(n->forwardNodes[i] != theList->head && n->forwardNodes[i]->id < search_id){
+            n = n->forwardNodes[i];
         }
-        theList->level = assign_level;
     }
 
-    n = (sl_node *) kmalloc(sizeof(sl_node),GFP_KERNEL);
-    if(!n){
-        printk("\nmymessege:: create_mb_empty n, kmalloc failure\n");
-        return;
+    if(n->forwardNodes[1] != theList->head && n->forwardNodes[1]->id == search_id){ // never hand out the head
+        return n->forwardNodes[1];
     }
-    printk("\nmymessege:: creat_mb_empty made it to 406\n");
-    n->id = insert_id;
-    n->mailBox = createQ(enqueue, dequeue, dumpQ, killQ);
-    n->forwardNodes = (sl_node **) kmalloc(((assign_level + 1) * sizeof(sl_node *)),GFP_KERNEL);
-    printk("\ncreat_mb_empty made it to 410\n");
-    for (i = 1; i <= assign_level; i++) {  // update all assigned levels with the info
-        n->forwardNodes[i] = updateSpot[i]->forwardNodes[i];
-        updateSpot[i]->forwardNodes[i] = n;
+    else{ // not an error, create and send look up missing ids on every call
+        return 0;
     }
-    printk("\nmymessege:: creat_mb_empty made it to 415\n");
 }
 
-static sl_node* search(unsigned long search_id){
+//search() that starts each level from finger[], the predecessors left by an earlier search
+//for a smaller or equal id, and leaves the predecessors of search_id in finger[] for the next one.
+//a batch searched in ascending id order walks the list forward once.
+static sl_node* search_finger(unsigned long search_id, sl_node** finger){
 
     sl_node* n = theList->head;
     unsigned int i;
     for(i = theList->level; i >= 1; i--){
-        while(n->forwardNodes[i] != 0 && n->forwardNodes[i]->id < search_id){
+        if(finger[i] != theList->head && finger[i]->id < search_id && (n == theList->head || finger[i]->id > n->id)){
+            n = finger[i]; // the finger is further along this level than the descent so far
+        }
+        while(n->forwardNodes[i] != theList->head && n->forwardNodes[i]->id < search_id){
             n = n->forwardNodes[i];
         }
+        finger[i] = n;
     }
 
-    if(n->forwardNodes[1]->id == search_id){
+    if(n->forwardNodes[1] != theList->head && n->forwardNodes[1]->id == search_id){
         return n->forwardNodes[1];
     }
-    else{
-        printk("mymessege:: error id value not found in skip_list, maybe you deleted it?");
-        return 0;
+    return 0;
+}
+
+//first node with an id >= from_id, theList->head when there is none
+static sl_node* search_from(unsigned long from_id){
+
+    sl_node* n = theList->head;
+    unsigned int i;
+    for(i = theList->level; i >= 1; i--){
+        while(n->forwardNodes[i] != theList->head && n->forwardNodes[i]->id < from_id){
+            n = n->forwardNodes[i];
+        }
     }
+    return n->forwardNodes[1];
 }
 
-static unsigned long delete(unsigned long delete_id){
-    sl_node* updateSpot[MAX_LEVEL+1];
+static long delete(unsigned long delete_id){
+    sl_node* updateSpot[MBX421_MAX_PTRS + 1];
     sl_node* n = theList->head;
     unsigned int i;
     for(i = theList->level; i >=1; i--){
-        while(n->forwardNodes[i]->id < delete_id){
+        while(n->forwardNodes[i] != theList->head && n->forwardNodes[i]->id < delete_id){
             n = n->forwardNodes[i];
         }
         updateSpot[i] = n;
     }
     n = n->forwardNodes[1];
-    if(n->id == delete_id){
+    if(n != theList->head && n->id == delete_id){ // the head is only freed by killAll
         for(i = 1; i <= theList->level; i++){
             if(updateSpot[i]->forwardNodes[i] != n){
                 break;
             }
             updateSpot[i]->forwardNodes[i] = n->forwardNodes[i];
         }
-        n->mailBox->killQ(&n->mailBox->front);
-        kfree(n->forwardNodes);
-        kfree(n);
+        free_sl_node(n);
         while (theList->level > 1 && theList->head->forwardNodes[theList->level] == theList->head) {
             theList->level--;
         }
@@ -462,22 +625,19 @@ static void dump(void){
     sl_node* n = theList->head;
     printk("\nmymessege:: dumping skip list(should be in order)");
     while(n && n->forwardNodes[1] != theList->head){
-        printk("\nmymessege:: MailBox ID [%lu] contains: ", n->forwardNodes[1]->id);
+        printk("\nmymessege:: MailBox ID [%lu] contains (%lu expired dropped): ", n->forwardNodes[1]->id, n->forwardNodes[1]->mailBox->dropped);
         n->forwardNodes[1]->mailBox->dumpQ(n->forwardNodes[1]->mailBox->front);
         n = n->forwardNodes[1];
     }
 }
 
 static void killAll(void){
-    sl_node* n = theList->head;
-    sl_node* temp = 0;
+    sl_node* head = theList->head;
 
-    while(n && n->forwardNodes[1] != theList->head){
-        temp = n->forwardNodes[1];
-        n = n->forwardNodes[1];
-        delete(temp->id);
+    while(head->forwardNodes[1] != head){ // delete frees the node, so always take the first one again
+        delete(head->forwardNodes[1]->id);
     }
-    delete(theList->head->id);
+    free_sl_node(head); // head is not a mailbox, delete refuses it
     kfree(theList);
     theList = 0;
 }
@@ -486,6 +646,63 @@ static void killAll(void){
 //===End SkipList==//
 //=================//
 
+//=================//
+//===Start Reaper==//
+//=================//
+//background expiry, each run looks at a bounded number of messages and resumes from
+//the last mailbox and queue position next time, so no single run holds the lock long
+//even when one abandoned mailbox holds millions of messages. mailboxes with nothing
+//stamped cost one pointer hop, and the work is only armed while stamped_total != 0.
+#define MBX421_REAP_BUDGET 1024 // messages visited per run
+#define MBX421_REAP_HOPS 65536 // mailboxes stepped over per run, bounds the walk past unstamped ones
+#define MBX421_REAP_PERIOD (HZ/10) // jiffies between runs
+
+static DEFINE_MUTEX(mbx_lock); // serializes the syscalls against the reaper
+
+static unsigned long reap_cursor = 0; // id the next run starts from
+
+static void reap_slice(struct work_struct* work);
+
+static DECLARE_DELAYED_WORK(reap_work, reap_slice);
+
+static void reap_slice(struct work_struct* work){
+    mutex_lock(&mbx_lock);
+    if(theList == 0){ // shut down, do not rearm
+        mutex_unlock(&mbx_lock);
+        return;
+    }
+
+    sl_node* n = search_from(reap_cursor);
+    unsigned int hops = 0;
+    long budget = MBX421_REAP_BUDGET;
+    while(n != theList->head && budget > 0 && hops < MBX421_REAP_HOPS){
+        //stamped, not ttl, decides: messages sent before the ttl was cleared can still expire
+        if(n->mailBox->stamped != 0 && !reapStepQ(n->mailBox, &budget)){
+            reap_cursor = n->id; // budget ran out inside this queue, continue it next run
+            break;
+        }
+        reap_cursor = n->id + 1;
+        n = n->forwardNodes[1];
+        hops++;
+    }
+    if(n == theList->head){
+        reap_cursor = 0; // reached the end, wrap around next run
+    }
+    if(stamped_total != 0){
+        arm_reaper(); // otherwise the next stamped send arms it again
+    }
+    mutex_unlock(&mbx_lock);
+}
+
+//queues the next run unless one is already pending, called with mbx_lock held
+static void arm_reaper(void){
+    schedule_delayed_work(&reap_work, MBX421_REAP_PERIOD);
+}
+
+//=================//
+//===End Reaper====//
+//=================//
+
 //======================//
 //===Start SystemCalls==//
 //======================//
@@ -493,55 +710,75 @@ static void killAll(void){
 
 
 
-SYSCALL_DEFINE2(mbx421_init, unsigned int, ptrs, unsigned int, prob){
+static long do_init(unsigned int ptrs, unsigned int prob){
 
     //checks for root access only
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;}; //not root
 
     if(prob != 2 && prob != 4 && prob != 8 && prob != 16) return -EINVAL;
-    if(ptrs == 0) return -EINVAL;
-    MAX_LEVEL = ptrs; // maximum number of pointers any single note may have.
-    PROBABILITY = prob; //prob 2,4,8,16?
-    if(theList == 0){
-        skip_list_init();
+    if(ptrs == 0 || ptrs > MBX421_MAX_PTRS) return -EINVAL;
+
+    long ret = 0;
+    mutex_lock(&mbx_lock);
+    if(theList == 0){ // the head node is sized by MAX_LEVEL, so it only changes with a new list
+        MAX_LEVEL = ptrs; // maximum number of pointers any single note may have.
+        PROBABILITY = prob; //prob 2,4,8,16?
+        ret = skip_list_init();
+        if(ret == 0){
+            reap_cursor = 0; // the reaper is armed by the first stamped send
+        }
     }
+    mutex_unlock(&mbx_lock);
 
-    return 0;
+    return ret;
 }
 
-
-SYSCALL_DEFINE0(mbx421_shutdown){
+static long do_shutdown(void){
     //root user 0 access only
-    printk("mymessege:: uid : %d : called shutdown:", current_uid());
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;}// not root
-    killAll();
+    cancel_delayed_work_sync(&reap_work); // reaper takes mbx_lock, stop it before locking
+    mutex_lock(&mbx_lock);
+    if(theList != 0){
+        killAll();
+    }
+    mutex_unlock(&mbx_lock);
     return 0;
 }
 
+SYSCALL_DEFINE2(mbx421_init, unsigned int, ptrs, unsigned int, prob){
+    return do_init(ptrs, prob);
+}
 
 
-SYSCALL_DEFINE1(mbx421_create, unsigned long, id){
+SYSCALL_DEFINE0(mbx421_shutdown){
+    printk("mymessege:: uid : %u : called shutdown:", from_kuid(&init_user_ns, current_uid()));
+    return do_shutdown();
+}
+
+
+
+//each mailbox operation is split into a do_ helper that takes the already searched node,
+//so the single syscalls and mbx421_submit share the same checks.
+
+static long do_create(unsigned long id, sl_node* temp){
     //root user 0 access only looking at uid only not euid
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} // not root
-    if(id == 0 || id == ((2^64)-1)) return -EINVAL; //invalid parameter
-    if(search(id) != 0) return -EEXIST; // mailbox already exists
+    if(theList == 0) return -ENOENT; //mbx421_init not called yet
+    if(id == 0 || id == MAXNUMBER) return -EINVAL; //invalid parameter, MAXNUMBER is the head node
+    if(temp != 0) return -EEXIST; // mailbox already exists
 
-    create_mb_empty(id);
+    if(create_mb_empty(id) == 0) return -ENOMEM;
     return 0;
 }
 
-
-
-SYSCALL_DEFINE1(mbx421_destroy, unsigned long, id){
+static long do_destroy(unsigned long id, sl_node* temp){
     //correct permissions or root
-    sl_node* temp;
-    temp = search(id);
     if(temp == 0){
         return -ENOENT;
     }
     if(temp->ACL !=0){ //if an ACL exists
         if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)){ // and the user is not root
-            if(!temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current))) { // and the user is not in the ACL list
+            if(temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current)) != 0) { // and the user is not in the ACL list (checkExist returns 0 when found)
                 return -EPERM; // then they dont have permission to execute this.
             }
         }
@@ -549,133 +786,207 @@ SYSCALL_DEFINE1(mbx421_destroy, unsigned long, id){
     return delete(id);
 }
 
+//send and recv are split around the lock: the user copy runs without mbx_lock, so a slow
+//or faulting user buffer only stalls the caller, and only the queue step is locked.
 
-SYSCALL_DEFINE1(mbx421_count, unsigned long, id){
-    //correct permissions or root
-    sl_node* temp;
-    temp = search(id);
-    if(temp == 0){
-        return -ENOENT;
-    }
-    if(temp->ACL !=0){ //if an ACL exists
-        if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)){ // and the user is not root
-            if(!temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current))) { // and the user is not in the ACL list
-                return -EPERM; // then they dont have permission to execute this.
-            }
-        }
+//copies a message in, no lock held, caller frees *out
+static long send_copy(const unsigned char __user * msg, long len, unsigned char** out){
+    if(len <= 0 || len > MBX421_MSG_MAX) return -EINVAL;
+
+    unsigned char *kernMsg;
+    kernMsg = (unsigned char*)kmalloc(len, GFP_KERNEL);
+    if(!kernMsg){
+        printk("\nmymessege:: send_copy kernMsg, kmalloc failure\n");
+        return -ENOMEM;
     }
-    if(temp != 0){
-        long count = temp->mailBox->dumpQ(temp->mailBox->front);
-        return count;
+    if(copy_from_user(kernMsg, msg, len) != 0){
+        kfree(kernMsg);
+        return -EFAULT; //bad pointer failure
     }
-   return -ENOENT; //mailbox DNE
+    *out = kernMsg;
+    return 0;
 }
 
-
-
-
-SYSCALL_DEFINE3(mbx421_send, unsigned long, id, const unsigned char __user *, msg, long, len){
+//queues an already copied message, caller holds mbx_lock and frees kernMsg on failure
+static long send_queue(unsigned long id, sl_node* temp, unsigned char* kernMsg, long len){
     //correct permissions or root
-    sl_node* temp;
-    temp = search(id);
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} // not root
 
-    unsigned long *kernMsg;
-    kernMsg = (unsigned long*)kmalloc((unsigned int)len, GFP_KERNEL);
-    if(sizeof(kernMsg) == 0){
-        printk("mymessege:: kernMsg not allocated properly at 572 sizeof(kernMsg) returned 0");
-        return -1;
-    }
-    unsigned long bytes_not_copied;
-    bytes_not_copied = copy_from_user(kernMsg,(const void*)msg, len);
-    if(bytes_not_copied == 0){ //successful converted to kern
-        insert(id,kernMsg);
-        return 0;
+    if(theList == 0) return -ENOENT; //mbx421_init not called yet
+
+    if(temp != 0){ //mailbox already found, skip the second walk insert() would do
+        return sendQ(temp->mailBox, (unsigned long)kernMsg, len);
     }
-    return -EFAULT; //bad pointer failure
+    return insert(id, (unsigned long)kernMsg, len);
 }
 
+static long do_send(unsigned long id, const unsigned char __user * msg, long len){
+    //root is checked again under the lock, this one just avoids copying for nothing
+    if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} // not root
 
+    unsigned char *kernMsg;
+    long ret = send_copy(msg, len, &kernMsg);
+    if(ret != 0) return ret;
 
-SYSCALL_DEFINE3(mbx421_recv, unsigned long, id, const unsigned char __user *, msg, long, len){
+    mutex_lock(&mbx_lock);
+    ret = send_queue(id, search(id), kernMsg, len);
+    mutex_unlock(&mbx_lock);
+
+    if(ret != 0){
+        kfree(kernMsg);
+    }
+    return ret;
+}
+
+//takes the next message off the queue, caller holds mbx_lock and hands *out to recv_copy
+static long recv_take(sl_node* temp, long len, q_node_t** out){
     //correct permissions or root
-    sl_node* temp;
-    temp = search(id);
     if(temp == 0){
         return -ENOENT;
     }
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} // not root
 
+    if(len <= 0) return -EINVAL;
+
+    expireQ(temp->mailBox);
+    q_node_t* node = recvQ(temp->mailBox);
+    if(node == 0){
+        return -EAGAIN; // mailbox is empty
+    }
+    *out = node;
+    return 0;
+}
 
+//copies a taken message out, no lock held. on a fault the message goes back to mailbox id
+//as the next one to receive, or is dropped if the mailbox was destroyed in the meantime.
+static long recv_copy(unsigned long id, q_node_t* node, unsigned char __user * msg, long len){
+    long copied = node->len < len ? node->len : len; //if messege size is larger then len size use the smaller(len)
+    if(copy_to_user(msg, (const void*)node->data, copied) == 0){
+        kfree((void*)node->data);
+        kfree(node);
+        return copied;
+    }
+
+    mutex_lock(&mbx_lock);
+    sl_node* temp = search(id);
     if(temp != 0){
-        unsigned long kernMsg = temp->mailBox->dequeue(&temp->mailBox->front);
+        unrecvQ(temp->mailBox, node); // keep the message for the next recv
+        node = 0;
+    }
+    mutex_unlock(&mbx_lock);
 
-        if(sizeof(kernMsg) >= len){ //if messege size is larger then len size use the smaller(len)
-            copy_to_user(msg, (const void*)kernMsg, len);
-            return len;
-        }
-        copy_to_user((void*)msg, kernMsg, sizeof(kernMsg));
-        return sizeof(kernMsg);
+    if(node != 0){
+        kfree((void*)node->data);
+        kfree(node);
     }
-    return -ENOENT; //mailbox DNE
+    return -EFAULT;
 }
 
+static long do_recv(unsigned long id, unsigned char __user * msg, long len){
+    q_node_t* node;
+    long ret;
 
+    mutex_lock(&mbx_lock);
+    ret = recv_take(search(id), len, &node);
+    mutex_unlock(&mbx_lock);
 
+    if(ret != 0) return ret;
+    return recv_copy(id, node, msg, len);
+}
 
-SYSCALL_DEFINE1(mbx421_length, unsigned long, id){
+static long do_count(sl_node* temp){
     //correct permissions or root
-    sl_node* temp;
-    temp = search(id);
     if(temp == 0){
         return -ENOENT;
     }
     if(temp->ACL !=0){ //if an ACL exists
         if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)){ // and the user is not root
-            if(!temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current))) { // and the user is not in the ACL list
+            if(temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current)) != 0) { // and the user is not in the ACL list (checkExist returns 0 when found)
                 return -EPERM; // then they dont have permission to execute this.
             }
         }
     }
-
     if(temp != 0){
-        if(!uid_eq(current_uid(), GLOBAL_ROOT_UID) && !temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current))) {return -EPERM;}
-        return sizeof((temp->mailBox->front->data));
+        expireQ(temp->mailBox);
+        long count = temp->mailBox->dumpQ(temp->mailBox->front);
+        return count;
     }
-    return -ENOENT;//mailbox DNE
+   return -ENOENT; //mailbox DNE
 }
 
+static long do_length(sl_node* temp){
+    //correct permissions or root
+    if(temp == 0){
+        return -ENOENT;
+    }
+    if(temp->ACL !=0){ //if an ACL exists
+        if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)){ // and the user is not root
+            if(temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current)) != 0) { // and the user is not in the ACL list (checkExist returns 0 when found)
+                return -EPERM; // then they dont have permission to execute this.
+            }
+        }
+    }
 
+    expireQ(temp->mailBox);
+    q_node_t* next = peekQ(temp->mailBox);
+    if(next == 0){
+        return -EAGAIN; // mailbox is empty
+    }
+    return next->len; // size of the message the next recv returns
+}
 
+static long do_set_ttl(sl_node* temp, unsigned long ttl_ms){
+    //root only
+    if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} //not root
 
+    if(temp == 0){
+        return -ENOENT; //mailbox dNE
+    }
+    temp->mailBox->ttl = msecs_to_jiffies(ttl_ms); //only messages sent from now on get the new ttl
+    return 0;
+}
 
-SYSCALL_DEFINE2(mbx421_acl_add, unsigned long, id, pid_t, process_id){
+static long do_dropped(sl_node* temp){
+    //correct permissions or root
+    if(temp == 0){
+        return -ENOENT;
+    }
+    if(temp->ACL !=0){ //if an ACL exists
+        if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)){ // and the user is not root
+            if(temp->ACL->checkExist(&temp->ACL->h, task_pid_nr(current)) != 0) { // and the user is not in the ACL list (checkExist returns 0 when found)
+                return -EPERM; // then they dont have permission to execute this.
+            }
+        }
+    }
+    expireQ(temp->mailBox);
+    return temp->mailBox->dropped;
+}
+
+static long do_acl_add(sl_node* temp, pid_t process_id){
     //root only
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} //not root
 
-    sl_node* temp;
-    temp = search(id);
-
     if (temp != 0) { // if the mailbox exists at all then continue
         if (temp->ACL == 0) { //if no ACL exist create one and insert into it
-            temp->ACL = createACL(killACL, insert_ACL_node, checkExist, deleteAllowedID, dumpList);
-            temp->ACL->insert_ACL_node(&temp->ACL->h, process_id);
+            ACL_LIST_T* ACL = createACL(killACL, insert_ACL_node, checkExist, deleteAllowedID, dumpList);
+            if(ACL == 0) return -ENOMEM;
+            if(ACL->insert_ACL_node(&ACL->h, process_id) != 0){
+                kfree(ACL); // an empty ACL would lock everyone but root out
+                return -ENOMEM;
+            }
+            temp->ACL = ACL;
             return 0;
         } else { //ACL exists insert to it.
-            temp->ACL->insert_ACL_node(&temp->ACL->h, process_id);
-            return 0;
+            return temp->ACL->insert_ACL_node(&temp->ACL->h, process_id);
         }
     }
     return -ENOENT; //mailbox dNE
 }
 
-SYSCALL_DEFINE2(mbx421_acl_remove, unsigned long, id, pid_t, process_id){
+static long do_acl_remove(sl_node* temp, pid_t process_id){
     //root only
     if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)) {return -EPERM;} //not root
 
-    sl_node* temp;
-    temp = search(id);
-
     if (temp != 0) { // if the mailbox exists at all then continue
         if (temp->ACL == 0) { //if no ACL exist no need to do anything just exit create one and insert into it
             return 0;
@@ -687,8 +998,93 @@ SYSCALL_DEFINE2(mbx421_acl_remove, unsigned long, id, pid_t, process_id){
     return -ENOENT; //mailbox dNE
 }
 
+
+
+SYSCALL_DEFINE1(mbx421_create, unsigned long, id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_create(id, search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE1(mbx421_destroy, unsigned long, id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_destroy(id, search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE1(mbx421_count, unsigned long, id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_count(search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE3(mbx421_send, unsigned long, id, const unsigned char __user *, msg, long, len){
+    return do_send(id, msg, len); // takes mbx_lock itself, around the queue step only
+}
+
+
+SYSCALL_DEFINE3(mbx421_recv, unsigned long, id, unsigned char __user *, msg, long, len){
+    return do_recv(id, msg, len); // takes mbx_lock itself, around the queue step only
+}
+
+
+SYSCALL_DEFINE1(mbx421_length, unsigned long, id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_length(search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE2(mbx421_acl_add, unsigned long, id, pid_t, process_id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_acl_add(search(id), process_id);
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE2(mbx421_acl_remove, unsigned long, id, pid_t, process_id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_acl_remove(search(id), process_id);
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE2(mbx421_set_ttl, unsigned long, id, unsigned long, ttl_ms){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_set_ttl(search(id), ttl_ms);
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
+
+SYSCALL_DEFINE1(mbx421_dropped, unsigned long, id){
+    long ret;
+    mutex_lock(&mbx_lock);
+    ret = do_dropped(search(id));
+    mutex_unlock(&mbx_lock);
+    return ret;
+}
+
 SYSCALL_DEFINE0(mbx421_dump){
+    mutex_lock(&mbx_lock);
     dump();
+    mutex_unlock(&mbx_lock);
     return 0;
 }
 
@@ -696,14 +1092,221 @@ SYSCALL_DEFINE0(mbx421_dump){
 
 
 
-//======================//
-//===End SystemCalls====//
-//======================//
+//=========================//
+//===Start SubmitRing======//
+//=========================//
+//userspace fills an array of submission entries (mbx421.h) for any mix of ids and ops,
+//one mbx421_submit call runs them all and writes one completion per entry.
+//entries run in id order so each chunk of the batch is one forward pass over the skip list,
+//entries on the same id keep their submission order and completions keep the array order.
+#define MBX421_SUBMIT_CHUNK 256 // entries run per mbx_lock hold
 
+typedef struct mbx421_sqe mbx421_sqe_t;
 
+typedef struct mbx421_cqe mbx421_cqe_t;
+
+typedef struct sqe_order {
+
+    unsigned long id;
+
+    unsigned int idx; // position in the submitted array
+
+} sqe_order_t;
+
+static int cmp_sqe_order(const void* a, const void* b){
+    const sqe_order_t* x = a;
+    const sqe_order_t* y = b;
+
+    if(x->id != y->id) return x->id < y->id ? -1 : 1;
+    return x->idx < y->idx ? -1 : (x->idx > y->idx); // tie break on position keeps per id order
+}
 
+static void reset_finger(sl_node** finger){
+    unsigned int i;
+    for(i = 0; i <= MAX_LEVEL; i++){
+        finger[i] = theList->head;
+    }
+}
 
+//runs one entry with mbx_lock held. send takes its payload from *slot, copied in before the
+//lock, and clears it once queued. recv leaves the taken message in *slot for the copy out after unlock.
+static long run_sqe(mbx421_sqe_t* sqe, sl_node** finger, void** slot){
+    sl_node* temp = search_finger(sqe->id, finger);
+    long ret;
+
+    switch(sqe->opcode){
+        case MBX421_OP_CREATE:
+            return do_create(sqe->id, temp);
+        case MBX421_OP_DESTROY:
+            ret = do_destroy(sqe->id, temp);
+            reset_finger(finger); //the freed node may be one of the fingers
+            return ret;
+        case MBX421_OP_SEND:
+            ret = send_queue(sqe->id, temp, (unsigned char*)*slot, sqe->len);
+            if(ret == 0){
+                *slot = 0; // the queue owns it now
+            }
+            return ret;
+        case MBX421_OP_RECV:
+            return recv_take(temp, sqe->len, (q_node_t**)slot);
+        case MBX421_OP_ACL_ADD:
+            return do_acl_add(temp, sqe->process_id);
+        case MBX421_OP_ACL_REMOVE:
+            return do_acl_remove(temp, sqe->process_id);
+        default:
+            return -EINVAL;
+    }
+}
 
+//copies every send payload in before the lock is taken, at most MBX421_SUBMIT_BYTES in total.
+//a send whose copy fails keeps its error in the completion and is skipped later.
+static long copy_batch(mbx421_sqe_t* kernSq, mbx421_cqe_t* kernCq, void** slot, unsigned int nr){
+    unsigned long bytes = 0;
+    unsigned int i;
 
+    if(!uid_eq(current_uid(), GLOBAL_ROOT_UID)){ // not root, fail the sends without copying anything
+        for(i = 0; i < nr; i++){
+            if(kernSq[i].opcode == MBX421_OP_SEND) kernCq[i].res = -EPERM;
+        }
+        return 0;
+    }
 
+    for(i = 0; i < nr; i++){
+        if(kernSq[i].opcode != MBX421_OP_SEND) continue;
+        if(kernSq[i].len <= 0 || kernSq[i].len > MBX421_MSG_MAX) continue; // send_copy reports it
+        bytes += kernSq[i].len;
+    }
+    if(bytes > MBX421_SUBMIT_BYTES) return -E2BIG;
+
+    for(i = 0; i < nr; i++){
+        if(kernSq[i].opcode != MBX421_OP_SEND) continue;
+        unsigned char* kernMsg;
+        long ret = send_copy(u64_to_user_ptr(kernSq[i].msg), kernSq[i].len, &kernMsg);
+        if(ret != 0){
+            kernCq[i].res = ret;
+            continue;
+        }
+        slot[i] = kernMsg;
+    }
+    return 0;
+}
+
+//runs the sorted entries under mbx_lock, dropping it every MBX421_SUBMIT_CHUNK entries
+//so a big batch never stalls the other callers long.
+static void run_sorted(mbx421_sqe_t* kernSq, mbx421_cqe_t* kernCq, void** slot, sqe_order_t* order, unsigned int nr){
+    sl_node* finger[MBX421_MAX_PTRS+1];
+    unsigned int i;
+
+    mutex_lock(&mbx_lock);
+    for(i = 0; i < nr; i++){
+        unsigned int idx = order[i].idx;
+
+        if(i % MBX421_SUBMIT_CHUNK == 0){
+            if(i != 0){
+                mutex_unlock(&mbx_lock);
+                cond_resched();
+                mutex_lock(&mbx_lock);
+            }
+            if(theList == 0) break; //not initialized, or shut down between chunks
+            reset_finger(finger); //the fingered nodes may have been destroyed while unlocked
+        }
+        if(kernSq[idx].opcode == MBX421_OP_SEND && slot[idx] == 0){
+            continue; // payload copy failed, the completion already holds why
+        }
+        kernCq[idx].res = run_sqe(&kernSq[idx], finger, &slot[idx]);
+    }
+    mutex_unlock(&mbx_lock);
+}
+
+//runs nr entries already copied into the kernel, takes mbx_lock itself.
+//payloads are copied in before the lock and received messages copied out after it.
+static long run_batch(mbx421_sqe_t* kernSq, mbx421_cqe_t* kernCq, unsigned int nr){
+    unsigned int i;
+
+    for(i = 0; i < nr; i++){
+        kernCq[i].user_data = kernSq[i].user_data;
+        kernCq[i].res = -ENOENT; //mbx421_init not called yet
+    }
+
+    sqe_order_t* order = (sqe_order_t*)kvmalloc_array(nr, sizeof(sqe_order_t), GFP_KERNEL);
+    if(!order){
+        printk("\nmymessege:: run_batch order, kmalloc failure\n");
+        return -ENOMEM;
+    }
+    void** slot = (void**)kvcalloc(nr, sizeof(void*), GFP_KERNEL);
+    if(!slot){
+        printk("\nmymessege:: run_batch slot, kmalloc failure\n");
+        kvfree(order);
+        return -ENOMEM;
+    }
+
+    long ret = copy_batch(kernSq, kernCq, slot, nr);
+    if(ret == 0){
+        for(i = 0; i < nr; i++){
+            order[i].id = kernSq[i].id;
+            order[i].idx = i;
+        }
+        sort(order, nr, sizeof(sqe_order_t), cmp_sqe_order, NULL);
+        run_sorted(kernSq, kernCq, slot, order, nr);
+    }
+
+    for(i = 0; i < nr; i++){
+        if(slot[i] == 0) continue;
+        if(kernSq[i].opcode == MBX421_OP_RECV){ // taken under the lock, copy it out now
+            kernCq[i].res = recv_copy(kernSq[i].id, (q_node_t*)slot[i], u64_to_user_ptr(kernSq[i].msg), kernSq[i].len);
+        }else{ // send payload that was never queued
+            kfree(slot[i]);
+        }
+    }
+    kvfree(slot);
+    kvfree(order);
+    return ret;
+}
+
+SYSCALL_DEFINE3(mbx421_submit, const mbx421_sqe_t __user *, sqes, mbx421_cqe_t __user *, cqes, unsigned int, nr){
+    if(nr == 0) return 0;
+    if(nr > MBX421_SUBMIT_MAX) return -EINVAL;
+
+    //up to ~160KB per array, kvmalloc falls back to vmalloc instead of needing contiguous pages
+    mbx421_sqe_t* kernSq = (mbx421_sqe_t*)kvmalloc_array(nr, sizeof(mbx421_sqe_t), GFP_KERNEL);
+    if(!kernSq){
+        printk("\nmymessege:: mbx421_submit kernSq, kmalloc failure\n");
+        return -ENOMEM;
+    }
+    mbx421_cqe_t* kernCq = (mbx421_cqe_t*)kvmalloc_array(nr, sizeof(mbx421_cqe_t), GFP_KERNEL);
+    if(!kernCq){
+        printk("\nmymessege:: mbx421_submit kernCq, kmalloc failure\n");
+        kvfree(kernSq);
+        return -ENOMEM;
+    }
+    if(copy_from_user(kernSq, sqes, nr * sizeof(mbx421_sqe_t)) != 0){
+        kvfree(kernSq);
+        kvfree(kernCq);
+        return -EFAULT;
+    }
+
+    long ret = run_batch(kernSq, kernCq, nr); // takes mbx_lock itself
+
+    if(ret == 0){
+        ret = nr; //number of completions written
+        if(copy_to_user(cqes, kernCq, nr * sizeof(mbx421_cqe_t)) != 0){
+            ret = -EFAULT;
+        }
+    }
+    kvfree(kernSq);
+    kvfree(kernCq);
+    return ret;
+}
+
+//=========================//
+//=====End SubmitRing======//
+//=========================//
+
+
+//======================//
+//===End SystemCalls====//
+//======================//
 
+#if IS_ENABLED(CONFIG_MBX421_KUNIT_TEST)
+#include "os-proj1-test.c"
+#endif